@@ -17,8 +17,29 @@
 
 #include "Graphics.h"
 
-Graphics::Graphics()
-        : _window(nullptr) {
+/**
+ * Create the emulator window.
+ *
+ * Every instance owns a cell in a single texture atlas, the cells are tiled
+ * in a near-square grid so a whole batch of instances is drawn with one
+ * texture and one copy per frame. The screens are upscaled on the CPU
+ * before they are stored in their cell, unless the scaler is SCALER_NONE.
+ *
+ * @param instances The number of instances shown in the window.
+ * @param scaler The upscaling algorithm of the screens.
+ */
+Graphics::Graphics(unsigned instances, ScalerMode scaler)
+        : _window(nullptr), _renderer(nullptr), _sdlTexture(nullptr), _width(WIN_WIDTH), _height(WIN_HEIGHT),
+          _instances(std::max(instances, 1u)), _cols(1), _rows(1),
+          _cell_width(GFX_WIDTH), _cell_height(GFX_HEIGHT), _dirty_top(0), _dirty_bottom(0), _any_dirty(true) {
+
+    _cols = (unsigned) std::ceil(std::sqrt((double) _instances));
+    _rows = (_instances + _cols - 1) / _cols;
+
+    // A single instance fills the classic window, a grid keeps its cells at least 2x.
+    const unsigned scale = window_scale(_instances);
+    _width = _cols * GFX_WIDTH * scale;
+    _height = _rows * GFX_HEIGHT * scale;
 
     // Initialize SDL
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
@@ -30,7 +51,7 @@ Graphics::Graphics()
     _window = SDL_CreateWindow(
             APP_NAME,
             SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-            WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_SHOWN
+            _width, _height, SDL_WINDOW_SHOWN
     );
 
     if (!_window) {
@@ -40,13 +61,181 @@ Graphics::Graphics()
 
     // Create renderer
     _renderer = SDL_CreateRenderer(_window, -1, 0);
-    SDL_RenderSetLogicalSize(_renderer, WIN_WIDTH, WIN_HEIGHT);
 
-    // Create texture that stores frame buffer
+    if (!_renderer) {
+        std::cout << "Renderer could not be created! SDL_Error:" << SDL_GetError() << std::endl;
+        exit(2);
+    }
+
+    SDL_RenderSetLogicalSize(_renderer, _width, _height);
+
+    // Shrink the scaling until the atlas fits in a single texture
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(_renderer, &info) < 0) {
+        std::cout << "Renderer info could not be queried! SDL_Error:" << SDL_GetError() << std::endl;
+        exit(2);
+    }
+
+    // The nearest scaler matches the window pixel for pixel.
+    unsigned factor = scale;
+    while (true) {
+        Scaler probe(scaler, GFX_WIDTH, GFX_HEIGHT, factor);
+        _cell_width = GFX_WIDTH * probe.get_factor();
+        _cell_height = GFX_HEIGHT * probe.get_factor();
+
+        if ((!info.max_texture_width || _cols * _cell_width <= (unsigned) info.max_texture_width) &&
+            (!info.max_texture_height || _rows * _cell_height <= (unsigned) info.max_texture_height))
+            break;
+
+        if (scaler == SCALER_NONE) {
+            std::cout << "Too many instances for a single texture of "
+                      << info.max_texture_width << "x" << info.max_texture_height << "." << std::endl;
+            exit(2);
+        }
+
+        if (scaler == SCALER_SCALE4X)
+            scaler = SCALER_SCALE2X;
+        else if (scaler == SCALER_NEAREST && factor > 2)
+            factor /= 2;
+        else
+            scaler = SCALER_NONE;
+
+        std::cout << "The atlas is too large for a single texture, scaling the screens down." << std::endl;
+    }
+
+    _scalers.assign(_instances, Scaler(scaler, GFX_WIDTH, GFX_HEIGHT, factor));
+    _atlas.assign(_cols * _cell_width * _rows * _cell_height, 0xFF000000);
+
+    // Whatever is left to stretch should stay blocky
+    if (scaler != SCALER_NONE)
+        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+
+    // Create texture that stores the frame buffers atlas
     _sdlTexture = SDL_CreateTexture(_renderer,
                                     SDL_PIXELFORMAT_ARGB8888,
                                     SDL_TEXTUREACCESS_STREAMING,
-                                    64, 32);
+                                    _cols * _cell_width, _rows * _cell_height);
+
+    if (!_sdlTexture) {
+        std::cout << "Texture could not be created! SDL_Error:" << SDL_GetError() << std::endl;
+        exit(2);
+    }
+
+    // Upload the blank atlas once, afterwards only changed rows are uploaded
+    SDL_UpdateTexture(_sdlTexture, NULL, _atlas.data(), _cols * _cell_width * sizeof(Uint32));
+}
+
+/**
+ * Scale the frame buffer of an instance into its atlas cell.
+ * Only the rows that changed are rewritten, and the texture itself is
+ * only updated on the next upload().
+ *
+ * @param index The index of the instance.
+ * @param pixels GFX_WIDTH * GFX_HEIGHT ARGB8888 pixels.
+ */
+void Graphics::update_instance(const unsigned index, const Uint32 *pixels) {
+    if (index >= _instances) {
+        std::cout << "Invalid instance index." << std::endl;
+        exit(1);
+    }
+
+    const unsigned pitch = _cols * _cell_width;
+    const unsigned x = (index % _cols) * _cell_width, y = (index / _cols) * _cell_height;
+    unsigned first_row, last_row;
+
+    if (!_scalers[index].scale(pixels, &_atlas[y * pitch + x], pitch, first_row, last_row))
+        return;
+
+    // Merge with the rows that are still waiting for an upload
+    _dirty_top = std::min(_dirty_top, y + first_row);
+    _dirty_bottom = std::max(_dirty_bottom, y + last_row + 1);
+
+    _any_dirty = true;
+}
+
+/**
+ * Upload the atlas rows that changed since the last upload to the texture,
+ * with a single update however many instances drew.
+ *
+ * @return Rather the window should be presented again.
+ */
+bool Graphics::upload() {
+    if (_dirty_top < _dirty_bottom) {
+        const unsigned pitch = _cols * _cell_width;
+        SDL_Rect band = {0, (int) _dirty_top, (int) pitch, (int) (_dirty_bottom - _dirty_top)};
+
+        SDL_UpdateTexture(_sdlTexture, &band, &_atlas[_dirty_top * pitch], pitch * sizeof(Uint32));
+
+        _dirty_top = _rows * _cell_height;
+        _dirty_bottom = 0;
+    }
+
+    return _any_dirty;
+}
+
+/**
+ * Present the whole atlas with a single copy, followed by the overlay if any.
+ * Does nothing if neither a cell nor the overlay changed.
+ *
+ * The overlay bars are stacked from the bottom up in the order they were given.
+ */
+void Graphics::present() {
+    if (!_any_dirty)
+        return;
+
+    SDL_SetRenderDrawColor(_renderer, 0, 0, 0, 0xFF);
+    SDL_RenderClear(_renderer);
+    SDL_RenderCopy(_renderer, _sdlTexture, NULL, NULL);
+
+    // Overlay bars are stacked from the bottom left corner
+    const int bar_height = std::max(2, _height / 64);
+    for (std::size_t i = 0; i < _overlay.size(); ++i) {
+        const Uint8 *color = _overlay[i].color;
+        double fraction = std::min(std::max(_overlay[i].fraction, 0.0), 1.0);
+        SDL_Rect bar = {0, (int) (_height - (i + 1) * bar_height), (int) (fraction * _width), bar_height - 1};
+
+        SDL_SetRenderDrawColor(_renderer, color[0], color[1], color[2], 0xFF);
+        SDL_RenderFillRect(_renderer, &bar);
+    }
+
+    SDL_RenderPresent(_renderer);
+
+    _any_dirty = false;
+}
+
+/**
+ * Replace the overlay drawn on top of the instances.
+ *
+ * @param bars The bars to draw, from the bottom up. Empty to hide the overlay.
+ */
+void Graphics::set_overlay(const std::vector<OverlayBar> &bars) {
+    if (bars.empty() && _overlay.empty())
+        return;
+
+    _overlay = bars;
+    _any_dirty = true;
+}
+
+/**
+ * @return The number of instances shown in the window.
+ */
+unsigned Graphics::get_instances() const {
+    return _instances;
+}
+
+/**
+ * The on-screen size of a single screen pixel.
+ *
+ * @param instances The number of instances shown in the window.
+ * @return The window pixels per screen pixel, in each direction.
+ */
+unsigned Graphics::window_scale(const unsigned instances) {
+    const unsigned cols = (unsigned) std::ceil(std::sqrt((double) std::max(instances, 1u)));
+
+    if (cols == 1)
+        return WIN_WIDTH / GFX_WIDTH;
+
+    return std::max(2u, (WIN_WIDTH / GFX_WIDTH) / cols);
 }
 
 /**
@@ -18,13 +18,27 @@
 #pragma once
 
 #include "type.h"
+#include "Scaler.h"
 #include "SDL2/SDL.h"
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cmath>
 
 #define WIN_WIDTH  (1024)
 #define WIN_HEIGHT (512)
 #define APP_NAME   ("Emuleightor")
 
+#define GFX_WIDTH  (64)
+#define GFX_HEIGHT (32)
+
+
+// A bar of the overlay, its length is a fraction of the window width.
+struct OverlayBar {
+    double fraction;
+    const Uint8 *color;
+};
+
 
 class Graphics {
 
@@ -49,15 +63,48 @@ public:
             SDLK_v,
     };
 
-    Graphics();
+    explicit Graphics(unsigned instances = 1, ScalerMode scaler = SCALER_NONE);
+
+    void update_instance(unsigned index, const Uint32 *pixels);
+
+    bool upload();
+
+    void present();
+
+    void set_overlay(const std::vector<OverlayBar> &bars);
+
+    unsigned get_instances() const;
 
     SDL_Renderer *get_renderer() const;
 
     SDL_Texture *get_sdlTexture() const;
 
+    static unsigned window_scale(unsigned instances);
+
 private:
     SDL_Window *_window;
     SDL_Renderer *_renderer;
     SDL_Texture *_sdlTexture;
 
+    int _width;
+    int _height;
+
+    unsigned _instances;
+    unsigned _cols;
+    unsigned _rows;
+
+    // The atlas frame buffer, one scaled screen per instance.
+    unsigned _cell_width;
+    unsigned _cell_height;
+    std::vector<Uint32> _atlas;
+    std::vector<Scaler> _scalers;
+
+    // The atlas rows that changed since the last upload, empty if top >= bottom.
+    unsigned _dirty_top;
+    unsigned _dirty_bottom;
+    bool _any_dirty;
+
+    // Overlay bars, stacked from the bottom up.
+    std::vector<OverlayBar> _overlay;
+
 };
@@ -0,0 +1,299 @@
+/**
+ * This file is part of Emuleightor.
+ *
+ * Emuleightor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Emuleightor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Emuleightor.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Scaler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/**
+ * @param mode The scaling algorithm.
+ * @param width The width of the source screen.
+ * @param height The height of the source screen.
+ * @param nearest_factor The integer factor used by the nearest mode.
+ */
+Scaler::Scaler(const ScalerMode mode, const unsigned width, const unsigned height, const unsigned nearest_factor)
+        : _mode(mode), _width(width), _height(height), _factor(1), _valid(false),
+          _previous(width * height, 0),
+          _changed(height, 0), _changed2x(height * 2, 0), _rows(height * 2, 0) {
+
+    switch (_mode) {
+        case SCALER_NEAREST:
+            _factor = std::max(nearest_factor, 1u);
+            break;
+        case SCALER_SCALE2X:
+            _factor = 2;
+            _padded.assign((width + 2) * (height + 2), 0);
+            break;
+        case SCALER_SCALE4X:
+            _factor = 4;
+            _padded.assign((width + 2) * (height + 2), 0);
+            _padded2x.assign((width * 2 + 2) * (height * 2 + 2), 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Scale a screen into the destination buffer.
+ * The destination must hold the output of the previous call, unless invalidate() was called.
+ *
+ * @param src width * height pixels.
+ * @param dst The output, (width * factor) x (height * factor) pixels.
+ * @param dst_pitch The distance between two output rows, in pixels.
+ * @param first_row Set to the first output row that was written.
+ * @param last_row Set to the last output row that was written.
+ * @return Rather any output row was written.
+ */
+bool Scaler::scale(const uint32_t *src, uint32_t *dst, const std::size_t dst_pitch,
+                   unsigned &first_row, unsigned &last_row) {
+    bool any = false;
+
+    // Find the source rows that changed since the previous frame
+    for (unsigned y = 0; y < _height; ++y) {
+        const uint32_t *row = src + y * _width;
+        uint32_t *previous = &_previous[y * _width];
+
+        _changed[y] = !_valid || std::memcmp(row, previous, _width * sizeof(uint32_t));
+        if (!_changed[y]) continue;
+
+        std::copy(row, row + _width, previous);
+        if (!_padded.empty())
+            std::copy(row, row + _width, &_padded[(y + 1) * (_width + 2) + 1]);
+        any = true;
+    }
+
+    _valid = true;
+
+    if (!any)
+        return false;
+
+    first_row = _height * _factor;
+    last_row = 0;
+
+    switch (_mode) {
+        case SCALER_NONE:
+        case SCALER_NEAREST:
+            for (unsigned y = 0; y < _height; ++y) {
+                if (!_changed[y]) continue;
+
+                uint32_t *out = dst + y * _factor * dst_pitch;
+                nearest_row(&_previous[y * _width], _width, _factor, out);
+                for (unsigned i = 1; i < _factor; ++i)
+                    std::copy(out, out + _width * _factor, out + i * dst_pitch);
+
+                first_row = std::min(first_row, y * _factor);
+                last_row = y * _factor + _factor - 1;
+            }
+            break;
+
+        case SCALER_SCALE2X:
+            pad(_padded.data(), _width, _height, _changed);
+            grow(_changed, _rows);
+
+            for (unsigned y = 0; y < _height; ++y) {
+                if (!_rows[y]) continue;
+
+                scale2x_row(_padded.data(), _width, y, dst + 2 * y * dst_pitch, dst + (2 * y + 1) * dst_pitch);
+
+                first_row = std::min(first_row, 2 * y);
+                last_row = 2 * y + 1;
+            }
+            break;
+
+        case SCALER_SCALE4X: {
+            // Scale4x is Scale2x applied twice, the intermediate frame is cached as well
+            const unsigned width2x = _width * 2, height2x = _height * 2, pitch2x = width2x + 2;
+
+            pad(_padded.data(), _width, _height, _changed);
+            grow(_changed, _rows);
+
+            std::fill(_changed2x.begin(), _changed2x.end(), 0);
+            for (unsigned y = 0; y < _height; ++y) {
+                if (!_rows[y]) continue;
+
+                scale2x_row(_padded.data(), _width, y,
+                            &_padded2x[(2 * y + 1) * pitch2x + 1], &_padded2x[(2 * y + 2) * pitch2x + 1]);
+                _changed2x[2 * y] = _changed2x[2 * y + 1] = 1;
+            }
+
+            pad(_padded2x.data(), width2x, height2x, _changed2x);
+            grow(_changed2x, _rows);
+
+            for (unsigned y = 0; y < height2x; ++y) {
+                if (!_rows[y]) continue;
+
+                scale2x_row(_padded2x.data(), width2x, y, dst + 2 * y * dst_pitch, dst + (2 * y + 1) * dst_pitch);
+
+                first_row = std::min(first_row, 2 * y);
+                last_row = 2 * y + 1;
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Forget the cached output, the next call to scale() recomputes every row.
+ */
+void Scaler::invalidate() {
+    _valid = false;
+}
+
+/**
+ * @return The scaling algorithm.
+ */
+ScalerMode Scaler::get_mode() const {
+    return _mode;
+}
+
+/**
+ * @return The ratio between the output and the source dimensions.
+ */
+unsigned Scaler::get_factor() const {
+    return _factor;
+}
+
+/**
+ * Parse the name of a scaling algorithm, as given on the command line.
+ *
+ * @param name One of none, nearest, scale2x or scale4x.
+ * @return The matching mode.
+ */
+ScalerMode Scaler::parse_mode(const std::string &name) {
+    if (name == "none") return SCALER_NONE;
+    if (name == "nearest") return SCALER_NEAREST;
+    if (name == "scale2x" || name == "epx") return SCALER_SCALE2X;
+    if (name == "scale4x") return SCALER_SCALE4X;
+
+    std::cout << "Unknown scaler: " << name << std::endl;
+    exit(1);
+}
+
+/**
+ * Repeat every pixel of a row factor times.
+ */
+void Scaler::nearest_row(const uint32_t *src, const unsigned width, const unsigned factor, uint32_t *dst) {
+    for (unsigned x = 0; x < width; ++x) {
+        uint32_t *out = dst + x * factor;
+        unsigned i = 0;
+
+#ifdef __SSE2__
+        __m128i pixel = _mm_set1_epi32((int) src[x]);
+        for (; i + 4 <= factor; i += 4)
+            _mm_storeu_si128((__m128i *) (out + i), pixel);
+#endif
+
+        for (; i < factor; ++i)
+            out[i] = src[x];
+    }
+}
+
+/**
+ * Scale2x (EPX) one row of a padded frame into two output rows.
+ *
+ *    A        E0 E1
+ *  C P B  ->  E2 E3
+ *    D
+ */
+void Scaler::scale2x_row(const uint32_t *padded, const unsigned width, const unsigned y,
+                         uint32_t *dst0, uint32_t *dst1) {
+    const uint32_t *up = padded + y * (width + 2) + 1;
+    const uint32_t *mid = up + width + 2;
+    const uint32_t *down = mid + width + 2;
+    const uint32_t *left = mid - 1;
+    unsigned x = 0;
+
+#ifdef __SSE2__
+    for (; x + 4 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *) (mid + x));
+        __m128i a = _mm_loadu_si128((const __m128i *) (up + x));
+        __m128i b = _mm_loadu_si128((const __m128i *) (mid + x + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *) (left + x));
+        __m128i d = _mm_loadu_si128((const __m128i *) (down + x));
+
+        __m128i ca = _mm_cmpeq_epi32(c, a), ab = _mm_cmpeq_epi32(a, b);
+        __m128i cd = _mm_cmpeq_epi32(c, d), bd = _mm_cmpeq_epi32(b, d);
+
+        // Every corner needs its two neighbours equal and both other pairs different
+        __m128i m0 = _mm_andnot_si128(_mm_or_si128(cd, ab), ca);
+        __m128i m1 = _mm_andnot_si128(_mm_or_si128(ca, bd), ab);
+        __m128i m2 = _mm_andnot_si128(_mm_or_si128(bd, ca), cd);
+        __m128i m3 = _mm_andnot_si128(_mm_or_si128(ab, cd), bd);
+
+        __m128i e0 = _mm_or_si128(_mm_and_si128(m0, a), _mm_andnot_si128(m0, p));
+        __m128i e1 = _mm_or_si128(_mm_and_si128(m1, b), _mm_andnot_si128(m1, p));
+        __m128i e2 = _mm_or_si128(_mm_and_si128(m2, c), _mm_andnot_si128(m2, p));
+        __m128i e3 = _mm_or_si128(_mm_and_si128(m3, d), _mm_andnot_si128(m3, p));
+
+        _mm_storeu_si128((__m128i *) (dst0 + 2 * x), _mm_unpacklo_epi32(e0, e1));
+        _mm_storeu_si128((__m128i *) (dst0 + 2 * x + 4), _mm_unpackhi_epi32(e0, e1));
+        _mm_storeu_si128((__m128i *) (dst1 + 2 * x), _mm_unpacklo_epi32(e2, e3));
+        _mm_storeu_si128((__m128i *) (dst1 + 2 * x + 4), _mm_unpackhi_epi32(e2, e3));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        uint32_t p = mid[x], a = up[x], b = mid[x + 1], c = left[x], d = down[x];
+
+        dst0[2 * x] = (c == a && c != d && a != b) ? a : p;
+        dst0[2 * x + 1] = (a == b && a != c && b != d) ? b : p;
+        dst1[2 * x] = (d == c && d != b && c != a) ? c : p;
+        dst1[2 * x + 1] = (b == d && b != a && d != c) ? d : p;
+    }
+}
+
+/**
+ * Refresh the border of a padded frame around the given rows.
+ */
+void Scaler::pad(uint32_t *padded, const unsigned width, const unsigned height, const std::vector<char> &rows) {
+    const unsigned pitch = width + 2;
+
+    for (unsigned y = 0; y < height; ++y) {
+        if (!rows[y]) continue;
+
+        uint32_t *row = padded + (y + 1) * pitch;
+        row[0] = row[1];
+        row[width + 1] = row[width];
+    }
+
+    if (rows[0])
+        std::copy(padded + pitch, padded + 2 * pitch, padded);
+
+    if (rows[height - 1])
+        std::copy(padded + height * pitch, padded + (height + 1) * pitch, padded + (height + 1) * pitch);
+}
+
+/**
+ * Mark the rows adjacent to the given rows as well.
+ */
+void Scaler::grow(const std::vector<char> &rows, std::vector<char> &grown) {
+    const std::size_t height = rows.size();
+
+    for (std::size_t y = 0; y < height; ++y)
+        grown[y] = rows[y] || (y > 0 && rows[y - 1]) || (y + 1 < height && rows[y + 1]);
+}
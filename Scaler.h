@@ -0,0 +1,83 @@
+/**
+ * This file is part of Emuleightor.
+ *
+ * Emuleightor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Emuleightor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Emuleightor.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+
+enum ScalerMode {
+    SCALER_NONE,
+    SCALER_NEAREST,
+    SCALER_SCALE2X,
+    SCALER_SCALE4X
+};
+
+
+/**
+ * CPU side pixel-art upscaler of a single screen.
+ *
+ * The output is cached in the destination buffer, every call only recomputes
+ * the output rows of the source rows that changed (and their neighbours,
+ * for the Scale2x/Scale4x modes which look one row up and down).
+ */
+class Scaler {
+
+public:
+    Scaler(ScalerMode mode, unsigned width, unsigned height, unsigned nearest_factor);
+
+    bool scale(const uint32_t *src, uint32_t *dst, std::size_t dst_pitch,
+               unsigned &first_row, unsigned &last_row);
+
+    void invalidate();
+
+    ScalerMode get_mode() const;
+
+    unsigned get_factor() const;
+
+    static ScalerMode parse_mode(const std::string &name);
+
+private:
+    static void nearest_row(const uint32_t *src, unsigned width, unsigned factor, uint32_t *dst);
+
+    static void scale2x_row(const uint32_t *padded, unsigned width, unsigned y, uint32_t *dst0, uint32_t *dst1);
+
+    static void pad(uint32_t *padded, unsigned width, unsigned height, const std::vector<char> &rows);
+
+    static void grow(const std::vector<char> &rows, std::vector<char> &grown);
+
+    ScalerMode _mode;
+    unsigned _width;
+    unsigned _height;
+    unsigned _factor;
+
+    bool _valid;
+
+    // The last source frame, to find the rows that changed.
+    std::vector<uint32_t> _previous;
+
+    // Frames with a one pixel border replicating their edges, for Scale2x/Scale4x.
+    std::vector<uint32_t> _padded;
+    std::vector<uint32_t> _padded2x;
+
+    std::vector<char> _changed;
+    std::vector<char> _changed2x;
+    std::vector<char> _rows;
+
+};
@@ -0,0 +1,89 @@
+/**
+ * This file is part of Emuleightor.
+ *
+ * Emuleightor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Emuleightor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Emuleightor.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "Scaler.h"
+
+
+#define SCREEN_WIDTH  (64)
+#define SCREEN_HEIGHT (32)
+#define NEAREST_FACTOR (16)
+#define ITERATIONS (5000)
+
+using namespace std;
+
+
+/**
+ * Time the scaling of ITERATIONS frames and print the p50/p99/max cost.
+ *
+ * @param full Rather every frame is scaled from scratch, or only a sprite sized change is.
+ */
+static void benchmark(const char *name, ScalerMode mode, bool full) {
+    Scaler scaler(mode, SCREEN_WIDTH, SCREEN_HEIGHT, NEAREST_FACTOR);
+    const unsigned factor = scaler.get_factor();
+
+    vector<uint32_t> screen(SCREEN_WIDTH * SCREEN_HEIGHT, 0xFF000000);
+    vector<uint32_t> output(screen.size() * factor * factor);
+    vector<double> samples;
+    unsigned first_row, last_row;
+
+    for (unsigned i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i += 3)
+        screen[i] = 0xFFFFFFFF;
+    scaler.scale(screen.data(), output.data(), SCREEN_WIDTH * factor, first_row, last_row);
+
+    for (unsigned i = 0; i < ITERATIONS; ++i) {
+        // Flip an 8x5 sprite, like a DRW of a font glyph
+        unsigned x = (i * 7) % (SCREEN_WIDTH - 8), y = (i * 5) % (SCREEN_HEIGHT - 5);
+        for (unsigned row = y; row < y + 5; ++row)
+            for (unsigned col = x; col < x + 8; ++col)
+                screen[row * SCREEN_WIDTH + col] ^= 0x00FFFFFF;
+
+        if (full)
+            scaler.invalidate();
+
+        auto start = chrono::steady_clock::now();
+        scaler.scale(screen.data(), output.data(), SCREEN_WIDTH * factor, first_row, last_row);
+        samples.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+
+    sort(samples.begin(), samples.end());
+    cout << left << setw(10) << name << setw(8) << (full ? "full" : "sprite")
+         << right << setw(4) << factor << "x"
+         << fixed << setprecision(2)
+         << setw(12) << samples[samples.size() / 2]
+         << setw(12) << samples[samples.size() * 99 / 100]
+         << setw(12) << samples.back() << endl;
+}
+
+
+int main() {
+    cout << left << setw(10) << "scaler" << setw(8) << "frame" << right << setw(5) << "scale"
+         << setw(12) << "p50 (us)" << setw(12) << "p99 (us)" << setw(12) << "max (us)" << endl;
+
+    for (bool full : {true, false}) {
+        benchmark("none", SCALER_NONE, full);
+        benchmark("nearest", SCALER_NEAREST, full);
+        benchmark("scale2x", SCALER_SCALE2X, full);
+        benchmark("scale4x", SCALER_SCALE4X, full);
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/**
+ * This file is part of Emuleightor.
+ *
+ * Emuleightor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Emuleightor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Emuleightor.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Stats.h"
+
+
+// The RGB color of every phase in the overlay, in Phase order.
+static const unsigned char phase_colors[][3] = {
+        {0x4C, 0xAF, 0x50}, // emulation: green
+        {0x21, 0x96, 0xF3}, // events: blue
+        {0xFF, 0xC1, 0x07}, // scale: amber
+        {0x9C, 0x27, 0xB0}, // upload: purple
+        {0xE9, 0x1E, 0x63}, // present: pink
+        {0x9E, 0x9E, 0x9E}, // sleep: grey
+        {0x79, 0x55, 0x48}, // report: brown
+        {0xF4, 0x43, 0x36}, // frame: red
+};
+
+static_assert(sizeof(phase_colors) / sizeof(phase_colors[0]) == PHASES_NUM,
+              "Every phase needs an overlay color");
+
+/**
+ * @param frame_budget_us The target duration of a host frame, in microseconds.
+ */
+Stats::Stats(const long frame_budget_us)
+        : _cursor(0), _filled(0),
+          _frame_start(clock::now()), _phase_start(_frame_start), _last_report(_frame_start),
+          _frame_budget_us(frame_budget_us), _sleep_requested_us(0),
+          _frames(0), _instructions(0), _late_frames(0), _dropped_frames(0),
+          _sleeps(0), _sleep_overshoot_us(0), _max_sleep_overshoot_us(0) {
+
+    for (auto &samples : _samples)
+        samples.assign(STATS_WINDOW, 0);
+}
+
+/**
+ * Start timing a new host frame.
+ * Phases that are skipped during the frame are recorded as zero.
+ */
+void Stats::begin_frame() {
+    for (auto &samples : _samples)
+        samples[_cursor] = 0;
+
+    _frame_start = _phase_start = clock::now();
+}
+
+/**
+ * Record the time spent since the previous phase ended (or the frame began).
+ *
+ * @param phase The phase that just ended.
+ */
+void Stats::end_phase(const Phase phase) {
+    clock::time_point now = clock::now();
+    double duration = std::chrono::duration<double, std::micro>(now - _phase_start).count();
+
+    _samples[phase][_cursor] += duration;
+    _phase_start = now;
+
+    if (phase == PHASE_SLEEP) {
+        double overshoot = duration - _sleep_requested_us;
+        _sleep_overshoot_us += overshoot;
+        _max_sleep_overshoot_us = std::max(_max_sleep_overshoot_us, overshoot);
+        ++_sleeps;
+    }
+}
+
+/**
+ * @param count The number of instructions executed during the current frame.
+ */
+void Stats::add_instructions(const unsigned long count) {
+    _instructions += count;
+}
+
+/**
+ * Announce the sleep that is about to happen, so its overshoot can be measured.
+ *
+ * @param requested_us The requested sleep duration, in microseconds.
+ */
+void Stats::add_sleep(const long requested_us) {
+    _sleep_requested_us = requested_us;
+}
+
+/**
+ * Finish the current frame.
+ *
+ * A frame is late when it runs over its budget by more than half,
+ * every whole budget it spans past the first counts as a dropped frame.
+ */
+void Stats::end_frame() {
+    double duration = elapsed_us(_frame_start);
+    _samples[PHASE_FRAME][_cursor] = duration;
+
+    if (duration > _frame_budget_us * 1.5)
+        ++_late_frames;
+
+    if (duration >= _frame_budget_us * 2)
+        _dropped_frames += (unsigned long) (duration / _frame_budget_us) - 1;
+
+    _cursor = (_cursor + 1) % STATS_WINDOW;
+    _filled = std::min<std::size_t>(_filled + 1, STATS_WINDOW);
+    ++_frames;
+}
+
+/**
+ * Returns rather STATS_INTERVAL_MS passed since the last time a report was due.
+ *
+ * @return Rather a report should be made.
+ */
+bool Stats::report_due() {
+    clock::time_point now = clock::now();
+
+    if (now - _last_report < std::chrono::milliseconds(STATS_INTERVAL_MS))
+        return false;
+
+    _last_report = now;
+    return true;
+}
+
+/**
+ * Summarize the last STATS_WINDOW frames of a phase.
+ *
+ * @param phase The phase to summarize.
+ * @return The p50, p99 and max durations of the phase, in microseconds.
+ */
+Stats::Summary Stats::summary(const Phase phase) const {
+    Summary result = {0, 0, 0};
+
+    if (!_filled)
+        return result;
+
+    std::vector<double> sorted(_samples[phase].begin(), _samples[phase].begin() + _filled);
+    std::sort(sorted.begin(), sorted.end());
+
+    result.p50 = sorted[(sorted.size() - 1) / 2];
+    result.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+    result.max = sorted.back();
+    return result;
+}
+
+/**
+ * Write all the counters as key=value lines.
+ *
+ * @param os The stream to write to.
+ */
+void Stats::report(std::ostream &os) const {
+    os << "frames=" << _frames << '\n'
+       << "instructions=" << _instructions << '\n'
+       << "instructions_per_frame=" << (_frames ? (double) _instructions / _frames : 0) << '\n'
+       << "late_frames=" << _late_frames << '\n'
+       << "dropped_frames=" << _dropped_frames << '\n'
+       << "sleep_overshoot_avg_us=" << (_sleeps ? _sleep_overshoot_us / _sleeps : 0) << '\n'
+       << "sleep_overshoot_max_us=" << _max_sleep_overshoot_us << '\n';
+
+    for (int phase = 0; phase < PHASES_NUM; ++phase) {
+        Summary s = summary((Phase) phase);
+        const char *name = phase_name((Phase) phase);
+
+        os << name << "_p50_us=" << s.p50 << '\n'
+           << name << "_p99_us=" << s.p99 << '\n'
+           << name << "_max_us=" << s.max << '\n';
+    }
+
+    os.flush();
+}
+
+/**
+ * Replace the content of a stats file with a fresh report.
+ * The report is written next to the file and renamed over it,
+ * so readers never see a partial report.
+ *
+ * @param path The path of the stats file.
+ */
+void Stats::write(const std::string &path) const {
+    const std::string temp_path = path + ".tmp";
+
+    {
+        std::ofstream stats_ofs(temp_path, std::ios::trunc);
+
+        if (stats_ofs.fail()) {
+            std::cout << "Can not write stats to: " << temp_path << std::endl;
+            return;
+        }
+
+        report(stats_ofs);
+    }
+
+    if (std::rename(temp_path.c_str(), path.c_str()))
+        std::cout << "Can not write stats to: " << path << std::endl;
+}
+
+/**
+ * @param phase A phase of the main loop.
+ * @return The name of the phase, as used in reports.
+ */
+const char *Stats::phase_name(const Phase phase) {
+    switch (phase) {
+        case PHASE_EMULATION:
+            return "emulation";
+        case PHASE_EVENTS:
+            return "events";
+        case PHASE_SCALE:
+            return "scale";
+        case PHASE_UPLOAD:
+            return "upload";
+        case PHASE_PRESENT:
+            return "present";
+        case PHASE_SLEEP:
+            return "sleep";
+        case PHASE_REPORT:
+            return "report";
+        case PHASE_FRAME:
+            return "frame";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @param phase A phase of the main loop.
+ * @return The RGB color of the phase in the overlay.
+ */
+const unsigned char *Stats::phase_color(const Phase phase) {
+    return phase_colors[phase];
+}
+
+/**
+ * @param since A point in time.
+ * @return The microseconds passed since that point.
+ */
+double Stats::elapsed_us(const clock::time_point since) const {
+    return std::chrono::duration<double, std::micro>(clock::now() - since).count();
+}
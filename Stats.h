@@ -0,0 +1,112 @@
+/**
+ * This file is part of Emuleightor.
+ *
+ * Emuleightor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Emuleightor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Emuleightor.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+
+
+#define STATS_WINDOW (1024)
+#define STATS_INTERVAL_MS (1000)
+
+
+// The phases of a host frame, in the order they run in the main loop.
+enum Phase {
+    PHASE_EMULATION,
+    PHASE_EVENTS,
+    PHASE_SCALE,
+    PHASE_UPLOAD,
+    PHASE_PRESENT,
+    PHASE_SLEEP,
+    PHASE_REPORT,
+    PHASE_FRAME,
+    PHASES_NUM
+};
+
+
+/**
+ * Per-frame telemetry of the main loop.
+ *
+ * Every phase keeps the durations of the last STATS_WINDOW frames in a ring,
+ * percentiles are only computed when a report is made so the per-frame cost
+ * is a clock read and a store per phase. The once a second reporting itself
+ * is timed as the report phase, so a slow stats file shows up in the frame time.
+ */
+class Stats {
+
+public:
+    struct Summary {
+        double p50;
+        double p99;
+        double max;
+    };
+
+    explicit Stats(long frame_budget_us);
+
+    void begin_frame();
+
+    void end_phase(Phase phase);
+
+    void add_instructions(unsigned long count);
+
+    void add_sleep(long requested_us);
+
+    void end_frame();
+
+    bool report_due();
+
+    Summary summary(Phase phase) const;
+
+    void report(std::ostream &os) const;
+
+    void write(const std::string &path) const;
+
+    static const char *phase_name(Phase phase);
+
+    static const unsigned char *phase_color(Phase phase);
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    inline double elapsed_us(clock::time_point since) const;
+
+    std::vector<double> _samples[PHASES_NUM];
+    std::size_t _cursor;
+    std::size_t _filled;
+
+    clock::time_point _frame_start;
+    clock::time_point _phase_start;
+    clock::time_point _last_report;
+
+    long _frame_budget_us;
+    long _sleep_requested_us;
+
+    unsigned long _frames;
+    unsigned long _instructions;
+    unsigned long _late_frames;
+    unsigned long _dropped_frames;
+    unsigned long _sleeps;
+    double _sleep_overshoot_us;
+    double _max_sleep_overshoot_us;
+
+};
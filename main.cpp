@@ -20,6 +20,7 @@
 
 #include "Graphics.h"
 #include "CPU.h"
+#include "Stats.h"
 
 
 #define DELAY (2000)
@@ -27,29 +28,175 @@
 using namespace std;
 
 
+/**
+ * Load the roms into their instances.
+ */
+static void load_games(vector<CPU> &cpus, vector<string> &roms) {
+    for (unsigned n = 0; n < cpus.size(); ++n)
+        cpus[n].load_game(roms[n]);
+}
+
+/**
+ * Store the screen of an instance as ARGB8888 pixels.
+ */
+static void read_pixels(const CPU &cpu, uint32_t *pixels) {
+    for (word i = 0; i < 2048; ++i) {
+        byte pixel = cpu.get_gfx_pixel(i);
+        pixels[i] = (0x00FFFFFF * pixel) | 0xFF000000;
+    }
+}
+
+/**
+ * Run the instances without a window, as fast as possible.
+ * The screens are still scaled, so the scale phase can be measured.
+ *
+ * @param frames The number of frames to run, 0 to run forever.
+ */
+static void run_headless(vector<CPU> &cpus, Stats &stats, const string &stats_path, unsigned long frames,
+                         ScalerMode mode) {
+    const unsigned scale = Graphics::window_scale(cpus.size());
+    vector<Scaler> scalers(cpus.size(), Scaler(mode, GFX_WIDTH, GFX_HEIGHT, scale));
+    const unsigned factor = scalers[0].get_factor();
+    vector<uint32_t> screens(cpus.size() * GFX_WIDTH * factor * GFX_HEIGHT * factor);
+    uint32_t pixels[2048];
+
+    for (unsigned long frame = 0; !frames || frame < frames; ++frame) {
+        stats.begin_frame();
+
+        for (CPU &cpu : cpus)
+            cpu.instruction_cycle();
+        stats.add_instructions(cpus.size());
+        stats.end_phase(PHASE_EMULATION);
+
+        for (unsigned n = 0; n < cpus.size(); ++n) {
+            if (!cpus[n].draw_flag()) continue;
+            cpus[n].set_draw_flag(false);
+
+            unsigned first_row, last_row;
+            read_pixels(cpus[n], pixels);
+            scalers[n].scale(pixels, &screens[n * GFX_WIDTH * factor * GFX_HEIGHT * factor],
+                             GFX_WIDTH * factor, first_row, last_row);
+        }
+        stats.end_phase(PHASE_SCALE);
+
+        // Report about once a second, to the stats file or else to the standard output
+        if (stats.report_due()) {
+            if (!stats_path.empty())
+                stats.write(stats_path);
+            else
+                stats.report(cout);
+        }
+        stats.end_phase(PHASE_REPORT);
+
+        stats.end_frame();
+    }
+
+    if (!stats_path.empty())
+        stats.write(stats_path);
+    stats.report(cout);
+}
+
+
+/**
+ * Build the overlay from the p99 of every phase, a full bar being twice the frame budget.
+ */
+static vector<OverlayBar> overlay_bars(const Stats &stats) {
+    vector<OverlayBar> bars;
+
+    for (int phase = 0; phase < PHASES_NUM; ++phase) {
+        OverlayBar bar = {stats.summary((Phase) phase).p99 / (2 * DELAY), Stats::phase_color((Phase) phase)};
+        bars.push_back(bar);
+    }
+
+    return bars;
+}
+
+/**
+ * Print how the emulator should be run.
+ */
+static int usage(const char *name) {
+    cout << "Usage: " << name
+         << " [--scaler <none|nearest|scale2x|scale4x>] [--stats <file>] [--overlay]"
+         << " [--headless [--frames <n>]] <ROM file> [<ROM file> ...]" << endl;
+    return -1;
+}
+
+
 int main(int argc, char **argv) {
 
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " <ROM file>" << endl;
-        return -1;
+    vector<string> roms;
+    string stats_path;
+    bool overlay = false, headless = false, frames_given = false;
+    ScalerMode scaler = SCALER_NONE;
+    unsigned long frames = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg(argv[i]);
+        bool has_value = i + 1 < argc;
+
+        if (arg.compare(0, 2, "--")) {
+            roms.push_back(arg);
+            continue;
+        }
+
+        if (arg == "--overlay")
+            overlay = true;
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg != "--stats" && arg != "--scaler" && arg != "--frames") {
+            cout << "Unknown option: " << arg << endl;
+            return usage(argv[0]);
+        } else if (!has_value) {
+            cout << "Missing value for: " << arg << endl;
+            return usage(argv[0]);
+        } else if (arg == "--stats")
+            stats_path = argv[++i];
+        else if (arg == "--scaler")
+            scaler = Scaler::parse_mode(argv[++i]);
+        else {
+            frames = strtoul(argv[++i], nullptr, 10);
+            frames_given = true;
+        }
+    }
+
+    if (frames_given && !headless) {
+        cout << "--frames requires --headless." << endl;
+        return usage(argv[0]);
+    }
+
+    if (roms.empty())
+        return usage(argv[0]);
+
+    // Every rom runs on its own CPU, all of them are tiled in one window.
+    const unsigned instances = roms.size();
+    vector<CPU> cpus(instances);
+    Stats stats(DELAY);
+
+    if (headless) {
+        load_games(cpus, roms);
+        run_headless(cpus, stats, stats_path, frames, scaler);
+        return 0;
     }
 
-    CPU cpu;
-    Graphics graphics;
+    Graphics graphics(instances, scaler);
 
 
-    // Load the specified rom.
+    // Load the specified roms.
     load:
-    std::string name(argv[1]);
-    cpu.load_game(name);
+    load_games(cpus, roms);
 
     uint32_t pixels[2048];
 
     // The main loop.
     while (true) {
-        cpu.instruction_cycle();
+        stats.begin_frame();
 
-        // Process SDL events
+        for (CPU &cpu : cpus)
+            cpu.instruction_cycle();
+        stats.add_instructions(instances);
+        stats.end_phase(PHASE_EMULATION);
+
+        // Process SDL events, the keypad is shared by all instances
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_QUIT) exit(0);
@@ -62,38 +209,59 @@ int main(int argc, char **argv) {
                 if (e.key.keysym.sym == SDLK_F1)
                     goto load;
 
+                if (e.key.keysym.sym == SDLK_F2) {
+                    overlay = !overlay;
+                    graphics.set_overlay(overlay ? overlay_bars(stats) : vector<OverlayBar>());
+                }
+
                 for (byte i = 0; i < 16; ++i)
                     if (e.key.keysym.sym == graphics.keymap[i])
-                        cpu.set_key(true, i);
+                        for (CPU &cpu : cpus)
+                            cpu.set_key(true, i);
             }
 
             // Process keyup events
             if (e.type == SDL_KEYUP)
                 for (byte i = 0; i < 16; ++i)
                     if (e.key.keysym.sym == graphics.keymap[i])
-                        cpu.set_key(false, i);
+                        for (CPU &cpu : cpus)
+                            cpu.set_key(false, i);
         }
+        stats.end_phase(PHASE_EVENTS);
 
-        // If draw occurred, redraw SDL screen
-        if (cpu.draw_flag()) {
-            cpu.set_draw_flag(false);
+        // Scale the screens of the instances that drew into the atlas
+        for (unsigned n = 0; n < instances; ++n) {
+            if (!cpus[n].draw_flag()) continue;
+            cpus[n].set_draw_flag(false);
 
-            // Store pixels in temporary buffer
-            for (word i = 0; i < 2048; ++i) {
-                byte pixel = cpu.get_gfx_pixel(i);
-                pixels[i] = (0x00FFFFFF * pixel) | 0xFF000000;
-            }
+            read_pixels(cpus[n], pixels);
+            graphics.update_instance(n, pixels);
+        }
+        stats.end_phase(PHASE_SCALE);
 
-            // Update SDL texture
-            SDL_UpdateTexture(graphics.get_sdlTexture(), NULL, pixels, 64 * sizeof(Uint32));
+        // Present once per frame, only if any instance redrew
+        bool redraw = graphics.upload();
+        stats.end_phase(PHASE_UPLOAD);
 
-            // Clear screen and render
-            SDL_RenderClear(graphics.get_renderer());
-            SDL_RenderCopy(graphics.get_renderer(), graphics.get_sdlTexture(), NULL, NULL);
-            SDL_RenderPresent(graphics.get_renderer());
+        if (redraw) {
+            graphics.present();
+            stats.end_phase(PHASE_PRESENT);
         }
 
+        stats.add_sleep(DELAY);
         std::this_thread::sleep_for(std::chrono::microseconds(DELAY));
+        stats.end_phase(PHASE_SLEEP);
+
+        // Refresh the overlay and the stats file about once a second
+        if (stats.report_due()) {
+            if (overlay)
+                graphics.set_overlay(overlay_bars(stats));
+
+            if (!stats_path.empty())
+                stats.write(stats_path);
+        }
+        stats.end_phase(PHASE_REPORT);
 
+        stats.end_frame();
     }
 }